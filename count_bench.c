@@ -1,4 +1,4 @@
-﻿// Benchmark and test program for count_u8.h and count_u16.h
+﻿// Benchmark and test program for count_u8.h, count_u16.h, count_u1.h and count_u4.h
 //
 //  SPDX-FileCopyrightText: Copyright (c) Takayuki Matsuoka
 //  SPDX-License-Identifier: CC0-1.0
@@ -7,6 +7,8 @@
 
 #include "count_u8.h"
 #include "count_u16.h"
+#include "count_u1.h"
+#include "count_u4.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -60,6 +62,20 @@ static void fill_random(uint8_t* mem, size_t memSizeInBytes, uint64_t seed) {
 }
 
 
+// When COUNT_LARGE_SCAN_THRESHOLD is defined, count_u8() and count_u16()
+// select large-scan mode by size.  Show the selection.  Its result is
+// verified with default_counters[].
+static void print_default_selection(size_t memSizeInBytes) {
+#if defined(COUNT_LARGE_SCAN_THRESHOLD)
+    static const char* const names[] = { "Scalar", "SSE2", "SSE2 NT" };
+    printf("Default selects %s (COUNT_LARGE_SCAN_THRESHOLD=%zd)\n",
+        names[count_u_select_kernel(memSizeInBytes)], (size_t) (COUNT_LARGE_SCAN_THRESHOLD));
+#else
+    (void) memSizeInBytes;
+#endif
+}
+
+
 static void bench_u8(uint8_t* mem, size_t memSizeInBytes) {
     printf("bench_u8()\n");
 
@@ -111,6 +127,17 @@ static void bench_u8(uint8_t* mem, size_t memSizeInBytes) {
         sse2_duration = end_clock(start);
     }
 
+    // SSE2 (non-temporal)
+    static size_t sse2nt_counters[nValue] = { 0 };
+    double sse2nt_duration = 0;
+    {
+        clock_t start = start_clock();
+        for(int v = 0; v < nValue; ++v) {
+            sse2nt_counters[v] = count_u8_sse2_nt(mem, memSizeInBytes, (uint8_t) v);
+        }
+        sse2nt_duration = end_clock(start);
+    }
+
     // Default
     static size_t default_counters[nValue] = { 0 };
     double default_duration = 0;
@@ -141,6 +168,12 @@ static void bench_u8(uint8_t* mem, size_t memSizeInBytes) {
         }
     }
 
+    for(int i = 0; i < nValue; ++i) {
+        if(naive_counters[i] != sse2nt_counters[i]) {
+            printf("Error: i=%3d, naive=%10zd, sse2nt=%10zd\n", i, naive_counters[i], sse2nt_counters[i]);
+        }
+    }
+
     for(int i = 0; i < nValue; ++i) {
         if(naive_counters[i] != default_counters[i]) {
             printf("Error: i=%3d, naive=%10zd, default=%10zd\n", i, naive_counters[i], default_counters[i]);
@@ -152,7 +185,9 @@ static void bench_u8(uint8_t* mem, size_t memSizeInBytes) {
     printf("IntLoop in%8.5f sec, speed%8.2f%%\n", intloop_duration, 100.0 * scalar_duration / intloop_duration);
     printf("Scalar  in%8.5f sec, speed%8.2f%%\n", scalar_duration,  100.0 * scalar_duration / scalar_duration);
     printf("SSE2    in%8.5f sec, speed%8.2f%%\n", sse2_duration,    100.0 * scalar_duration / sse2_duration);
+    printf("SSE2 NT in%8.5f sec, speed%8.2f%%\n", sse2nt_duration,  100.0 * scalar_duration / sse2nt_duration);
     printf("Default in%8.5f sec, speed%8.2f%%\n", default_duration, 100.0 * scalar_duration / default_duration);
+    print_default_selection(memSizeInBytes);
 }
 
 
@@ -225,6 +260,18 @@ static void bench_u16(uint8_t* mem, size_t memSizeInBytes) {
         sse2_duration = end_clock(start);
     }
 
+    // SSE2 (non-temporal)
+    static size_t sse2nt_counters[nValue] = { 0 };
+    double sse2nt_duration = 0;
+    {
+        clock_t start = start_clock();
+        for(int value = 0; value < nValue; ++value) {
+            const uint32_t vl = value * mult;
+            sse2nt_counters[value] = count_u16_sse2_nt(mem, memSizeInBytes, vl);
+        }
+        sse2nt_duration = end_clock(start);
+    }
+
     // Default
     static size_t default_counters[nValue] = { 0 };
     double default_duration = 0;
@@ -256,6 +303,12 @@ static void bench_u16(uint8_t* mem, size_t memSizeInBytes) {
         }
     }
 
+    for(int i = 0; i < nValue; ++i) {
+        if(naive_counters[i] != sse2nt_counters[i]) {
+            printf("Error: i=%3d, naive=%10zd, sse2nt=%10zd\n", i, naive_counters[i], sse2nt_counters[i]);
+        }
+    }
+
     for(int i = 0; i < nValue; ++i) {
         if(naive_counters[i] != default_counters[i]) {
             printf("Error: i=%3d, naive=%10zd, default=%10zd\n", i, naive_counters[i], default_counters[i]);
@@ -267,6 +320,165 @@ static void bench_u16(uint8_t* mem, size_t memSizeInBytes) {
     printf("IntLoop in%8.5f sec, speed%8.2f%%\n", intloop_duration, 100.0 * scalar_duration / intloop_duration);
     printf("Scalar  in%8.5f sec, speed%8.2f%%\n", scalar_duration,  100.0 * scalar_duration / scalar_duration);
     printf("SSE2    in%8.5f sec, speed%8.2f%%\n", sse2_duration,    100.0 * scalar_duration / sse2_duration);
+    printf("SSE2 NT in%8.5f sec, speed%8.2f%%\n", sse2nt_duration,  100.0 * scalar_duration / sse2nt_duration);
+    printf("Default in%8.5f sec, speed%8.2f%%\n", default_duration, 100.0 * scalar_duration / default_duration);
+    print_default_selection(memSizeInBytes);
+}
+
+
+static void bench_u1(uint8_t* mem, size_t memSizeInBytes) {
+    printf("bench_u1()\n");
+
+    fill_random(mem, memSizeInBytes, 0x0123456789abcdefULL);
+
+    // Since count_u1() doesn't take value, we just repeat the same counting.
+    enum { nRepeat = 16 };
+
+    // Scalar (naive)
+    static size_t naive_counters[nRepeat] = { 0 };
+    double naive_duration = 0;
+    {
+        clock_t start = start_clock();
+        for(int r = 0; r < nRepeat; ++r) {
+            naive_counters[r] = count_u1_scalar_naive(mem + r, memSizeInBytes - r);
+        }
+        naive_duration = end_clock(start);
+    }
+
+    // Scalar (SWAR)
+    static size_t scalar_counters[nRepeat] = { 0 };
+    double scalar_duration = 0;
+    {
+        clock_t start = start_clock();
+        for(int r = 0; r < nRepeat; ++r) {
+            scalar_counters[r] = count_u1_scalar(mem + r, memSizeInBytes - r);
+        }
+        scalar_duration = end_clock(start);
+    }
+
+    // SSE2
+    static size_t sse2_counters[nRepeat] = { 0 };
+    double sse2_duration = 0;
+    {
+        clock_t start = start_clock();
+        for(int r = 0; r < nRepeat; ++r) {
+            sse2_counters[r] = count_u1_sse2(mem + r, memSizeInBytes - r);
+        }
+        sse2_duration = end_clock(start);
+    }
+
+    // Default
+    static size_t default_counters[nRepeat] = { 0 };
+    double default_duration = 0;
+    {
+        clock_t start = start_clock();
+        for(int r = 0; r < nRepeat; ++r) {
+            default_counters[r] = count_u1(mem + r, memSizeInBytes - r);
+        }
+        default_duration = end_clock(start);
+    }
+
+    // Verify
+    for(int i = 0; i < nRepeat; ++i) {
+        if(naive_counters[i] != scalar_counters[i]) {
+            printf("Error: i=%3d, naive=%10zd, scalar=%10zd\n", i, naive_counters[i], scalar_counters[i]);
+        }
+    }
+
+    for(int i = 0; i < nRepeat; ++i) {
+        if(naive_counters[i] != sse2_counters[i]) {
+            printf("Error: i=%3d, naive=%10zd, sse2=%10zd\n", i, naive_counters[i], sse2_counters[i]);
+        }
+    }
+
+    for(int i = 0; i < nRepeat; ++i) {
+        if(naive_counters[i] != default_counters[i]) {
+            printf("Error: i=%3d, naive=%10zd, default=%10zd\n", i, naive_counters[i], default_counters[i]);
+        }
+    }
+
+    // Result
+    printf("Naive   in%8.5f sec, speed%8.2f%%\n", naive_duration,   100.0 * scalar_duration / naive_duration);
+    printf("Scalar  in%8.5f sec, speed%8.2f%%\n", scalar_duration,  100.0 * scalar_duration / scalar_duration);
+    printf("SSE2    in%8.5f sec, speed%8.2f%%\n", sse2_duration,    100.0 * scalar_duration / sse2_duration);
+    printf("Default in%8.5f sec, speed%8.2f%%\n", default_duration, 100.0 * scalar_duration / default_duration);
+}
+
+
+static void bench_u4(uint8_t* mem, size_t memSizeInBytes) {
+    printf("bench_u4()\n");
+
+    fill_random(mem, memSizeInBytes, 0x0123456789abcdefULL);
+
+    enum { nValue = 16 };
+
+    // Scalar (naive)
+    static size_t naive_counters[nValue] = { 0 };
+    double naive_duration = 0;
+    {
+        clock_t start = start_clock();
+        for(int v = 0; v < nValue; ++v) {
+            naive_counters[v] = count_u4_scalar_naive(mem + v, memSizeInBytes - v, (uint8_t) v);
+        }
+        naive_duration = end_clock(start);
+    }
+
+    // Scalar (default)
+    static size_t scalar_counters[nValue] = { 0 };
+    double scalar_duration = 0;
+    {
+        clock_t start = start_clock();
+        for(int v = 0; v < nValue; ++v) {
+            scalar_counters[v] = count_u4_scalar(mem + v, memSizeInBytes - v, (uint8_t) v);
+        }
+        scalar_duration = end_clock(start);
+    }
+
+    // SSE2
+    static size_t sse2_counters[nValue] = { 0 };
+    double sse2_duration = 0;
+    {
+        clock_t start = start_clock();
+        for(int v = 0; v < nValue; ++v) {
+            sse2_counters[v] = count_u4_sse2(mem + v, memSizeInBytes - v, (uint8_t) v);
+        }
+        sse2_duration = end_clock(start);
+    }
+
+    // Default
+    static size_t default_counters[nValue] = { 0 };
+    double default_duration = 0;
+    {
+        clock_t start = start_clock();
+        for(int v = 0; v < nValue; ++v) {
+            default_counters[v] = count_u4(mem + v, memSizeInBytes - v, (uint8_t) v);
+        }
+        default_duration = end_clock(start);
+    }
+
+    // Verify
+    for(int i = 0; i < nValue; ++i) {
+        if(naive_counters[i] != scalar_counters[i]) {
+            printf("Error: i=%3d, naive=%10zd, scalar=%10zd\n", i, naive_counters[i], scalar_counters[i]);
+        }
+    }
+
+    for(int i = 0; i < nValue; ++i) {
+        if(naive_counters[i] != sse2_counters[i]) {
+            printf("Error: i=%3d, naive=%10zd, sse2=%10zd\n", i, naive_counters[i], sse2_counters[i]);
+        }
+    }
+
+    for(int i = 0; i < nValue; ++i) {
+        if(naive_counters[i] != default_counters[i]) {
+            printf("Error: i=%3d, naive=%10zd, default=%10zd\n", i, naive_counters[i], default_counters[i]);
+        }
+    }
+
+    // Result
+    printf("Naive   in%8.5f sec, speed%8.2f%%\n", naive_duration,   100.0 * scalar_duration / naive_duration);
+    printf("Scalar  in%8.5f sec, speed%8.2f%%\n", scalar_duration,  100.0 * scalar_duration / scalar_duration);
+    printf("SSE2    in%8.5f sec, speed%8.2f%%\n", sse2_duration,    100.0 * scalar_duration / sse2_duration);
     printf("Default in%8.5f sec, speed%8.2f%%\n", default_duration, 100.0 * scalar_duration / default_duration);
 }
 
@@ -274,13 +486,19 @@ static void bench_u16(uint8_t* mem, size_t memSizeInBytes) {
 int main(int argc, char** argv) {
     int enable_bench_u8  = 0;
     int enable_bench_u16 = 0;
+    int enable_bench_u1  = 0;
+    int enable_bench_u4  = 0;
     for(int i = 1; i < argc; ++i) {
         if(strcmp(argv[i], "--u8")  == 0) { enable_bench_u8  = 1; continue; }
         if(strcmp(argv[i], "--u16") == 0) { enable_bench_u16 = 1; continue; }
+        if(strcmp(argv[i], "--u1")  == 0) { enable_bench_u1  = 1; continue; }
+        if(strcmp(argv[i], "--u4")  == 0) { enable_bench_u4  = 1; continue; }
     }
-    if(enable_bench_u8 == 0 && enable_bench_u16 == 0) {
+    if(enable_bench_u8 == 0 && enable_bench_u16 == 0 && enable_bench_u1 == 0 && enable_bench_u4 == 0) {
         enable_bench_u8  = 1;
         enable_bench_u16 = 1;
+        enable_bench_u1  = 1;
+        enable_bench_u4  = 1;
     }
 
     // Since MSVC doesn't have C11 standard aligned_alloc(),
@@ -291,6 +509,8 @@ int main(int argc, char** argv) {
     void* mem = _mm_malloc(size, alignment);
     if(enable_bench_u8)  { bench_u8((uint8_t*) mem, size);  }
     if(enable_bench_u16) { bench_u16((uint8_t*) mem, size); }
+    if(enable_bench_u1)  { bench_u1((uint8_t*) mem, size);  }
+    if(enable_bench_u4)  { bench_u4((uint8_t*) mem, size);  }
     _mm_free(mem);
     return 0;
 }
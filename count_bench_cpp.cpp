@@ -0,0 +1,465 @@
+﻿// Benchmark and test program for count_u8.hpp
+//
+//  SPDX-FileCopyrightText: Copyright (c) Takayuki Matsuoka
+//  SPDX-License-Identifier: CC0-1.0
+//  https://spdx.org/licenses/CC0-1.0
+//  https://creativecommons.org/publicdomain/zero/1.0/
+
+#include "count_u8.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if !defined(_MSC_VER)
+#  include <unistd.h>     // sysconf()
+#endif
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+void fill_random(std::span<uint8_t> mem, uint64_t seed) {
+    uint64_t y = seed;
+    for(auto& m : mem) {
+        y ^= y << 11;   // xorshift PRNG
+        y ^= y >> 31;
+        y ^= y << 18;
+        m = (uint8_t) y;
+    }
+}
+
+
+void fill_random_u16(std::span<uint16_t> mem, uint64_t seed, uint64_t mult) {
+    uint64_t y = seed;
+    for(size_t i = 0; i < mem.size(); i += 2) {
+        y ^= y << 11;   // xorshift PRNG
+        y ^= y >> 31;
+        y ^= y << 18;
+        mem[i] = (uint16_t) ((y & 0xff) * mult);
+    }
+}
+
+
+// Run f(value) for each value, and returns duration in seconds.
+template<size_t N, class F>
+double run(size_t (&counters)[N], F f) {
+    const auto start = clock_type::now();
+    for(size_t i = 0; i < N; ++i) {
+        counters[i] = f(i);
+    }
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+
+template<size_t N>
+void verify(const char* name, const size_t (&expected)[N], const size_t (&actual)[N]) {
+    for(size_t i = 0; i < N; ++i) {
+        if(expected[i] != actual[i]) {
+            printf("Error: i=%3zd, c=%10zd, %s=%10zd\n", i, expected[i], name, actual[i]);
+        }
+    }
+}
+
+
+// Verify parallel count with odd size and offset, so chunk edges are
+// uneven.  nForcedChunk splits the region even on single-threaded machine.
+template<class T, class V>
+void verify_par_odd(std::span<const T> mem, V valueOf) {
+    constexpr size_t nForcedChunk = 7;
+    const auto odd = mem.subspan(1, mem.size() - 17);
+
+    for(size_t i = 0; i < 256; i += 51) {
+        const T      value    = valueOf(i);
+        const size_t expected = count_u::count<count_u::kernel::scalar>(odd, value);
+        const size_t par      = count_u::count(std::execution::par, odd, value);
+        const size_t forced   = count_u::detail::count_par_<count_u::kernel::automatic>(odd, value, nForcedChunk);
+        const size_t forcedNt = count_u::detail::count_par_<count_u::kernel::sse2_nt>(odd, value, nForcedChunk);
+        if(par != expected || forced != expected || forcedNt != expected) {
+            printf("Error: odd size, i=%3zd, scalar=%10zd, par=%10zd, par(%zd chunks)=%10zd, par_nt(%zd chunks)=%10zd\n",
+                i, expected, par, nForcedChunk, forced, nForcedChunk, forcedNt);
+        }
+    }
+    printf("Par     checked with size-17 at offset 1 (%zd and %zd chunks)\n", count_u::detail::num_chunks_(odd), nForcedChunk);
+}
+
+
+// Compare C API (count_u8(), count_u16()) and count_u::count().
+//  valueOf(i) converts index to the value to count.
+template<class T, class V>
+void bench(std::span<const T> mem, V valueOf) {
+    enum { nValue = 256 };
+
+    static size_t c_counters[nValue];
+    static size_t scalar_counters[nValue];
+    static size_t sse2_counters[nValue];
+    static size_t sse2nt_counters[nValue];
+    static size_t default_counters[nValue];
+    static size_t seq_counters[nValue];
+    static size_t par_counters[nValue];
+
+    const double c_duration = run(c_counters, [&](size_t i) {
+        if constexpr(std::is_same_v<T, uint8_t>) {
+            return count_u8(mem.data(), mem.size_bytes(), valueOf(i));
+        } else {
+            return count_u16(mem.data(), mem.size_bytes(), valueOf(i));
+        }
+    });
+
+    const double scalar_duration = run(scalar_counters, [&](size_t i) {
+        return count_u::count<count_u::kernel::scalar>(mem, valueOf(i));
+    });
+
+    const double sse2_duration = run(sse2_counters, [&](size_t i) {
+        return count_u::count<count_u::kernel::sse2>(mem, valueOf(i));
+    });
+
+    const double sse2nt_duration = run(sse2nt_counters, [&](size_t i) {
+        return count_u::count<count_u::kernel::sse2_nt>(mem, valueOf(i));
+    });
+
+    const double default_duration = run(default_counters, [&](size_t i) {
+        return count_u::count(mem, valueOf(i));
+    });
+
+    const double seq_duration = run(seq_counters, [&](size_t i) {
+        return count_u::count(std::execution::seq, mem, valueOf(i));
+    });
+
+    const double par_duration = run(par_counters, [&](size_t i) {
+        return count_u::count(std::execution::par, mem, valueOf(i));
+    });
+
+    // Verify
+    verify("scalar",  c_counters, scalar_counters);
+    verify("sse2",    c_counters, sse2_counters);
+    verify("sse2nt",  c_counters, sse2nt_counters);
+    verify("default", c_counters, default_counters);
+    verify("seq",     c_counters, seq_counters);
+    verify("par",     c_counters, par_counters);
+
+    // Result
+    printf("C       in%8.5f sec, speed%8.2f%%\n", c_duration,       100.0 * c_duration / c_duration);
+    printf("Scalar  in%8.5f sec, speed%8.2f%%\n", scalar_duration,  100.0 * c_duration / scalar_duration);
+    printf("SSE2    in%8.5f sec, speed%8.2f%%\n", sse2_duration,    100.0 * c_duration / sse2_duration);
+    printf("SSE2 NT in%8.5f sec, speed%8.2f%%\n", sse2nt_duration,  100.0 * c_duration / sse2nt_duration);
+    printf("Default in%8.5f sec, speed%8.2f%%\n", default_duration, 100.0 * c_duration / default_duration);
+    printf("Seq     in%8.5f sec, speed%8.2f%%\n", seq_duration,     100.0 * c_duration / seq_duration);
+    printf("Par     in%8.5f sec, speed%8.2f%%\n", par_duration,     100.0 * c_duration / par_duration);
+
+    const size_t nChunk = count_u::detail::num_chunks_(mem);
+    printf("Par     uses %zd chunk(s), hardware_concurrency=%u%s\n",
+        nChunk, std::thread::hardware_concurrency(),
+        nChunk == 1 ? " (same as Seq on this machine)" : "");
+
+    verify_par_odd(mem, valueOf);
+}
+
+
+void bench_u8(std::span<uint8_t> mem) {
+    printf("bench_u8()\n");
+
+    fill_random(mem, 0x0123456789abcdefULL);
+
+    bench<uint8_t>(mem, [](size_t i) { return (uint8_t) i; });
+}
+
+
+void bench_u16(std::span<uint16_t> mem) {
+    printf("bench_u16()\n");
+
+    const uint32_t mult = 0x12341357;
+
+    fill_random_u16(mem, 0x0123456789abcdefULL, mult);
+
+    bench<uint16_t>(mem, [mult](size_t i) { return (uint16_t) (i * mult); });
+}
+
+// Cache size in bytes.  Returns fallback if it's unknown.
+size_t cache_size(int level, size_t fallback) {
+#if defined(_SC_LEVEL2_CACHE_SIZE) && defined(_SC_LEVEL3_CACHE_SIZE)
+    const long s = sysconf(level == 2 ? _SC_LEVEL2_CACHE_SIZE : _SC_LEVEL3_CACHE_SIZE);
+    if(s > 0) {
+        return (size_t) s;
+    }
+#else
+    (void) level;
+#endif
+    return fallback;
+}
+
+
+// Victim working set.  Each cache line holds index of the next line.
+// Lines are linked in random order to defeat hardware prefetcher, so walk
+// duration reflects the number of cache misses.  Pages are visited in
+// random order, and all lines of a page are visited (in random order)
+// before moving to the next page.  It keeps TLB misses to one per page,
+// so they don't hide cache misses of large victims.
+constexpr size_t victimLineSize     = 64;
+constexpr size_t victimLinesPerPage = 4096 / victimLineSize;
+
+uint64_t xorshift(uint64_t& y) {
+    y ^= y << 11;
+    y ^= y >> 31;
+    y ^= y << 18;
+    return y;
+}
+
+
+void shuffle(std::span<size_t> a, uint64_t& y) {
+    for(size_t i = a.size(); i > 1; --i) {
+        std::swap(a[i - 1], a[xorshift(y) % i]);
+    }
+}
+
+
+// Returns the number of linked lines (a multiple of victimLinesPerPage).
+size_t init_victim(std::span<uint8_t> victim, uint64_t seed) {
+    const size_t nPage = victim.size() / (victimLineSize * victimLinesPerPage);
+    const size_t nLine = nPage * victimLinesPerPage;
+    std::vector<size_t> pages(nPage);
+    std::vector<size_t> order(nLine);
+    for(size_t i = 0; i < nPage; ++i) {
+        pages[i] = i;
+    }
+
+    uint64_t y = seed;
+    shuffle(pages, y);
+    for(size_t p = 0; p < nPage; ++p) {
+        const auto o = std::span(order).subspan(p * victimLinesPerPage, victimLinesPerPage);
+        for(size_t l = 0; l < victimLinesPerPage; ++l) {
+            o[l] = pages[p] * victimLinesPerPage + l;
+        }
+        shuffle(o, y);
+    }
+
+    for(size_t i = 0; i < nLine; ++i) {
+        const size_t next = order[(i + 1) % nLine];
+        memcpy(&victim[order[i] * victimLineSize], &next, sizeof(next));
+    }
+    return nLine;
+}
+
+
+// Follow nStep links from idx, and returns the last index.
+size_t walk_victim(const uint8_t* victim, size_t idx, size_t nStep) {
+    for(size_t i = 0; i < nStep; ++i) {
+        memcpy(&idx, &victim[idx * victimLineSize], sizeof(idx));
+    }
+    return idx;
+}
+
+
+// Single threaded walk latency (ns/line) of already linked victim.
+double walk_latency(const uint8_t* victim, size_t nStep) {
+    size_t idx = walk_victim(victim, 0, nStep);     // warm up
+    const auto start = clock_type::now();
+    idx = walk_victim(victim, idx, nStep);
+    const double sec = std::chrono::duration<double>(clock_type::now() - start).count();
+    static std::atomic<size_t> sink;
+    sink += idx;
+    return 1e9 * sec / (double) nStep;
+}
+
+
+// Measure cache pollution caused by large scan to a concurrent victim.
+//
+//  A victim thread walks the victim working set repeatedly, while the
+//  calling thread
+//
+//    None    : sleeps,
+//    SSE2    : scans mem by count_u8_sse2() (prefetcht0),
+//    SSE2 NT : scans mem by count_u8_sse2_nt() (prefetchnta).
+//
+//  We don't read hardware miss counters.  Instead, victim walk latency per
+//  line is reported as a proxy of victim miss rate:  "None" is the all-hit
+//  baseline, and slower walk means more victim lines are evicted by the
+//  scan.  The row is meaningful only when "None" is well below DRAM latency
+//  (dramNsPerLine), so the caller checks it before.
+void bench_victim(std::span<const uint8_t> mem, std::span<const uint8_t> victim, size_t nLine, double dramNsPerLine) {
+    printf("bench_victim()\n");
+
+    static const char* const names[] = { "None   ", "SSE2   ", "SSE2 NT" };
+    constexpr int nMode    = 3;
+    constexpr int warmUp   = -1;
+    constexpr double minPhaseSec = 1.0;
+
+    struct Walk { double sec = 0; size_t lines = 0; };
+    Walk walks[nMode];
+    double scanSec[nMode]   = {};
+    size_t scanBytes[nMode] = {};
+
+    std::atomic<int>    phase { warmUp };
+    std::atomic<size_t> sink  { 0 };
+    {
+        // Walks which straddle a phase change are discarded.
+        // walks[] is only written by this thread and read after join().
+        std::jthread victimThread([&] {
+            size_t idx = 0;
+            for(;;) {
+                const int p0 = phase.load();
+                if(p0 >= nMode) {
+                    break;
+                }
+                const auto start = clock_type::now();
+                idx = walk_victim(victim.data(), idx, nLine);
+                const double sec = std::chrono::duration<double>(clock_type::now() - start).count();
+                if(p0 >= 0 && phase.load() == p0) {
+                    walks[p0].sec   += sec;
+                    walks[p0].lines += nLine;
+                }
+            }
+            sink += idx;
+        });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        for(int mode = 0; mode < nMode; ++mode) {
+            phase.store(mode);
+            const auto start = clock_type::now();
+            double sec = 0;
+            for(uint8_t value = 0; sec < minPhaseSec; ++value) {
+                switch(mode) {
+                default:
+                case 0: std::this_thread::sleep_for(std::chrono::duration<double>(minPhaseSec)); break;
+                case 1: sink += count_u8_sse2(mem.data(), mem.size(), value);    scanBytes[mode] += mem.size(); break;
+                case 2: sink += count_u8_sse2_nt(mem.data(), mem.size(), value); scanBytes[mode] += mem.size(); break;
+                }
+                sec = std::chrono::duration<double>(clock_type::now() - start).count();
+            }
+            scanSec[mode] = sec;
+        }
+        phase.store(nMode);
+        victimThread.join();
+    }
+
+    // Result
+    printf("Victim working set = %zd KiB, scan = %zd MiB, DRAM = %.2f ns/line, hardware_concurrency=%u%s\n",
+        nLine * victimLineSize / 1024, mem.size() / (1024 * 1024), dramNsPerLine,
+        std::thread::hardware_concurrency(),
+        std::thread::hardware_concurrency() == 1 ? " (victim and scan share one CPU)" : "");
+    if(walks[0].lines == 0) {
+        printf("Error: victim thread didn't complete a walk\n");
+        return;
+    }
+    const double baseNsPerLine = 1e9 * walks[0].sec / (double) walks[0].lines;
+    for(int mode = 0; mode < nMode; ++mode) {
+        if(walks[mode].lines == 0) {
+            printf("%s victim thread didn't complete a walk\n", names[mode]);
+            continue;
+        }
+        const double nsPerLine = 1e9 * walks[mode].sec / (double) walks[mode].lines;
+        printf("%s victim walk%8.2f ns/line (%6.2fx of None, miss rate proxy)", names[mode], nsPerLine, nsPerLine / baseNsPerLine);
+        if(scanBytes[mode] != 0) {
+            printf(", scan%7.2f GB/s", (double) scanBytes[mode] / scanSec[mode] / 1e9);
+        }
+        printf("\n");
+    }
+    if(baseNsPerLine * 2 > dramNsPerLine) {
+        printf("Warning: None is not well below DRAM latency, victim rows are not meaningful\n");
+    }
+    printf("(sink=%zd)\n", sink.load());
+}
+
+
+// Run bench_victim() with victims sized by L2 and LLC, and scan region well
+// above LLC.  victimSize / scanSize (bytes) override them if non-zero.
+void bench_victims(size_t victimSize, size_t scanSize) {
+    const size_t l2  = cache_size(2, 1024 * 1024);
+    const size_t llc = cache_size(3, 1024 * 1024 * 32);
+    if(scanSize == 0) {
+        scanSize = llc * 4;
+    }
+    printf("L2 = %zd KiB, LLC = %zd KiB\n", l2 / 1024, llc / 1024);
+
+    const size_t alignment = 65536;
+    uint8_t* scan = (uint8_t*) _mm_malloc(scanSize, alignment);
+    if(scan == nullptr) {
+        printf("Error: can't allocate scan region (%zd MiB)\n", scanSize / (1024 * 1024));
+        return;
+    }
+    const std::span<uint8_t> mem(scan, scanSize);
+
+    // DRAM latency : the same walk over the scan region, which is well above
+    // LLC.  We only walk a part of it, since it takes a while.
+    double dramNsPerLine = 0;
+    {
+        const size_t nLine = init_victim(mem, 0x0f1e2d3c4b5a6978ULL);
+        dramNsPerLine = walk_latency(scan, std::min<size_t>(nLine / 4, 1 << 20));
+    }
+    fill_random(mem, 0x0123456789abcdefULL);
+
+    // Victim candidates : half of L2 (L2 pollution), and a quarter of LLC
+    // halved down to 2x L2 (LLC pollution).  A candidate is used only when
+    // its single threaded walk latency is well below DRAM latency.
+    std::vector<size_t> candidates;
+    if(victimSize != 0) {
+        candidates.push_back(victimSize);
+    } else {
+        candidates.push_back(l2 / 2);
+        for(size_t s = llc / 4; s >= l2 * 2; s /= 2) {
+            candidates.push_back(s);
+        }
+    }
+
+    bool llcVictimFound = false;
+    for(const size_t size : candidates) {
+        const bool isLlcVictim = victimSize == 0 && size > l2;
+        if(isLlcVictim && llcVictimFound) {
+            continue;
+        }
+
+        uint8_t* v = (uint8_t*) _mm_malloc(size, alignment);
+        if(v == nullptr) {
+            printf("Error: can't allocate victim (%zd KiB)\n", size / 1024);
+            continue;
+        }
+        const size_t nLine = init_victim(std::span(v, size), 0xfedcba9876543210ULL);
+        const double ns = nLine ? walk_latency(v, nLine) : 0;
+        if(nLine != 0 && ns * 2 <= dramNsPerLine) {
+            bench_victim(mem, std::span(v, size), nLine, dramNsPerLine);
+            llcVictimFound |= isLlcVictim;
+        } else {
+            printf("Victim working set = %zd KiB : skipped, walk %.2f ns/line is not well below DRAM %.2f ns/line\n",
+                size / 1024, ns, dramNsPerLine);
+        }
+        _mm_free(v);
+    }
+
+    _mm_free(scan);
+}
+
+} // namespace
+
+
+int main(int argc, char** argv) {
+    int enable_bench_u8  = 0;
+    int enable_bench_u16 = 0;
+    int enable_bench_victim = 0;
+    size_t victimSize = 0;  // 0 : L2 and LLC sized victims
+    size_t scanSize   = 0;  // 0 : 4x LLC
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--u8")  == 0) { enable_bench_u8  = 1; continue; }
+        if(strcmp(argv[i], "--u16") == 0) { enable_bench_u16 = 1; continue; }
+        if(strcmp(argv[i], "--victim") == 0) { enable_bench_victim = 1; continue; }
+        if(strncmp(argv[i], "--victim-kib=", 13) == 0) { enable_bench_victim = 1; victimSize = (size_t) strtoull(argv[i] + 13, nullptr, 10) * 1024;        continue; }
+        if(strncmp(argv[i], "--scan-mib=",   11) == 0) { enable_bench_victim = 1; scanSize   = (size_t) strtoull(argv[i] + 11, nullptr, 10) * 1024 * 1024; continue; }
+    }
+    // bench_victims() is not included by default, since it allocates a large
+    // scan region (4x LLC) and takes a while.  Use --victim to run it.
+    if(enable_bench_u8 == 0 && enable_bench_u16 == 0 && enable_bench_victim == 0) {
+        enable_bench_u8  = 1;
+        enable_bench_u16 = 1;
+    }
+
+    // See count_bench.c for _mm_malloc().
+    const size_t size = 1024 * 1024 * 32;
+    const size_t alignment = 65536;
+    void* mem = _mm_malloc(size, alignment);
+    if(enable_bench_u8)  { bench_u8(std::span((uint8_t*) mem, size));                      }
+    if(enable_bench_u16) { bench_u16(std::span((uint16_t*) mem, size / sizeof(uint16_t))); }
+    _mm_free(mem);
+
+    if(enable_bench_victim) { bench_victims(victimSize, scanSize); }
+    return 0;
+}
@@ -0,0 +1,195 @@
+﻿// Count the number of set bits in memory region.
+// Header-only library in C99.  Optimized for SSE2.
+//
+// # Usage
+//
+//      size_t bufSize = 65536;
+//      uint8_t* buf = (uint8_t*) malloc(bufSize);
+//
+//      ... set_some_values(buf, bufSize); ...
+//
+//      size_t numBits = count_u1(buf, bufSize);
+//
+//  count_u1() automatically detect supported instruction by compiler's
+//  predefined symbols such as __SSE2__, _M_X64.
+//
+//
+// # References
+//
+// - Intel Intrinsics Guide
+//   https://software.intel.com/sites/landingpage/IntrinsicsGuide/
+// - Wojciech Mula, Nathan Kurz, Daniel Lemire,
+//   "Faster Population Counts Using AVX2 Instructions"
+//   https://arxiv.org/abs/1611.07612
+//
+//
+// # License
+//
+//  SPDX-FileCopyrightText: Copyright (c) Takayuki Matsuoka
+//  SPDX-License-Identifier: CC0-1.0
+//  https://spdx.org/licenses/CC0-1.0
+//  https://creativecommons.org/publicdomain/zero/1.0/
+
+#ifndef COUNT_U1_H
+#define COUNT_U1_H
+
+#include "count_u_select.h"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#elif defined(__GNUC__)
+#  include <x86intrin.h>
+#else
+#  error
+#endif
+
+// Scalar (naive)
+static inline size_t count_u1_scalar_naive(const void* src, size_t srcSizeInBytes) {
+    const uint8_t* data = (const uint8_t*) src;
+    uint64_t counter = 0;
+    for(size_t i = 0; i < srcSizeInBytes; ++i) {
+        for(int b = 0; b < 8; ++b) {
+            counter += (data[i] >> b) & 1;
+        }
+    }
+    return (size_t) counter;
+}
+
+
+// Scalar (SWAR, 64bit)
+static inline size_t count_u1_scalar(const void* src, size_t srcSizeInBytes) {
+    const uint64_t m1  = 0x5555555555555555ULL;
+    const uint64_t m2  = 0x3333333333333333ULL;
+    const uint64_t m4  = 0x0f0f0f0f0f0f0f0fULL;
+    const uint64_t h01 = 0x0101010101010101ULL;
+
+    const uint8_t* const    data        = (const uint8_t*) src;
+    const uint8_t* const    endOfData   = data + srcSizeInBytes;
+    const uint8_t* const    endOfU64    = endOfData - (srcSizeInBytes % sizeof(uint64_t));
+
+    uint64_t counter = 0;
+    for(const uint8_t* p = data; p < endOfU64; p += sizeof(uint64_t)) {
+        uint64_t x;
+        memcpy(&x, p, sizeof(x));
+        x = x - ((x >> 1) & m1);
+        x = (x & m2) + ((x >> 2) & m2);
+        x = (x + (x >> 4)) & m4;
+        counter += (x * h01) >> 56;
+    }
+
+    for(const uint8_t* q = endOfU64; q < endOfData; ++q) {
+        uint32_t x = *q;
+        x = x - ((x >> 1) & 0x55);
+        x = (x & 0x33) + ((x >> 2) & 0x33);
+        counter += (x + (x >> 4)) & 0x0f;
+    }
+
+    return (size_t) counter;
+}
+
+
+// SSE2
+//
+//  note: Harley-Seal
+//
+//  Each loop reads four vectors (a, b, c, d) and feeds them to carry-save
+//  adders (CSA).  CSA(h, l, a, b, c) computes bitwise full-adder:
+//
+//      h = (a & b) | ((a ^ b) & c);    // carry
+//      l = a ^ b ^ c;                  // sum
+//
+//  We keep "ones" and "twos" as running bit-sliced counters.  Only the
+//  "fours" output, which is produced once per loop, needs an actual
+//  population count.  At the end, the total is
+//
+//      4 * sum(popcnt(fours)) + 2 * popcnt(twos) + popcnt(ones)
+//
+//  Population count of a vector is computed by SWAR in each 8bit lane
+//  and reduced by _mm_sad_epu8() against zero, like count_u8_sse2().
+static inline __m128i count_u1_sse2_popcnt_64x2_(__m128i v) {
+    const __m128i m1_8x16 = _mm_set1_epi8(0x55);
+    const __m128i m2_8x16 = _mm_set1_epi8(0x33);
+    const __m128i m4_8x16 = _mm_set1_epi8(0x0f);
+    v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi16(v, 1), m1_8x16));
+    v = _mm_add_epi8(_mm_and_si128(v, m2_8x16), _mm_and_si128(_mm_srli_epi16(v, 2), m2_8x16));
+    v = _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi16(v, 4)), m4_8x16);
+    return _mm_sad_epu8(v, _mm_setzero_si128());
+}
+
+static inline size_t count_u1_sse2(const void* src, size_t srcSizeInBytes) {
+    const uint64_t          bytesPerLoop    = 16 * 4;
+    const int               prefetchLen     = 4096;
+
+    const uint8_t* const    data            = (const uint8_t*) src;
+    const uint8_t* const    endOfData       = data + srcSizeInBytes;
+    const uint8_t* const    endOfSimdPart   = endOfData - (srcSizeInBytes % bytesPerLoop);
+
+    uint64_t simdPartCounter = 0;
+    {
+        __m128i         fours_64x2  = _mm_setzero_si128();
+        __m128i         twos        = _mm_setzero_si128();
+        __m128i         ones        = _mm_setzero_si128();
+
+        for(const uint8_t* p = data; p < endOfSimdPart; p += bytesPerLoop) {
+            const uint8_t*  prefetchPtr     = p + prefetchLen;
+#if defined(_MSC_VER)
+            _mm_prefetch((const char*) prefetchPtr, _MM_HINT_T0);
+#elif defined(__GNUC__)
+            __builtin_prefetch(prefetchPtr, 0, 3);
+#else
+#  error
+#endif
+
+            const __m128i*  m               = (const __m128i *) p;
+            const __m128i   a               = _mm_loadu_si128(m  );
+            const __m128i   b               = _mm_loadu_si128(m+1);
+            const __m128i   c               = _mm_loadu_si128(m+2);
+            const __m128i   d               = _mm_loadu_si128(m+3);
+
+            // CSA(twosA, ones, ones, a, b)
+            const __m128i   uab             = _mm_xor_si128(ones, a);
+            const __m128i   twosA           = _mm_or_si128(_mm_and_si128(ones, a), _mm_and_si128(uab, b));
+            ones = _mm_xor_si128(uab, b);
+
+            // CSA(twosB, ones, ones, c, d)
+            const __m128i   ucd             = _mm_xor_si128(ones, c);
+            const __m128i   twosB           = _mm_or_si128(_mm_and_si128(ones, c), _mm_and_si128(ucd, d));
+            ones = _mm_xor_si128(ucd, d);
+
+            // CSA(fours, twos, twos, twosA, twosB)
+            const __m128i   utw             = _mm_xor_si128(twos, twosA);
+            const __m128i   fours           = _mm_or_si128(_mm_and_si128(twos, twosA), _mm_and_si128(utw, twosB));
+            twos = _mm_xor_si128(utw, twosB);
+
+            fours_64x2 = _mm_add_epi64(fours_64x2, count_u1_sse2_popcnt_64x2_(fours));
+        }
+
+        __m128i sumt_64x2;
+        sumt_64x2 = _mm_slli_epi64(fours_64x2, 2);
+        sumt_64x2 = _mm_add_epi64(sumt_64x2, _mm_slli_epi64(count_u1_sse2_popcnt_64x2_(twos), 1));
+        sumt_64x2 = _mm_add_epi64(sumt_64x2, count_u1_sse2_popcnt_64x2_(ones));
+
+        uint64_t counters[2];
+        _mm_storeu_si128((__m128i*) counters, sumt_64x2);
+
+        simdPartCounter  = (counters[0] + counters[1]);
+    }
+
+    const uint64_t lastPartCounter = count_u1_scalar(endOfSimdPart, (size_t) (endOfData - endOfSimdPart));
+
+    return (size_t) (simdPartCounter + lastPartCounter);
+}
+
+
+// "Default".  Select SSE2 if it's available.
+static inline size_t count_u1(const void* src, size_t srcSizeInBytes) {
+#if defined(COUNT_U_HAS_SSE2)
+    return count_u1_sse2(src, srcSizeInBytes);
+#else
+    return count_u1_scalar(src, srcSizeInBytes);
+#endif
+}
+
+#endif // COUNT_U1_H
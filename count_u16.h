@@ -14,6 +14,13 @@
 //  count_u16() automatically detect supported instruction by compiler's
 //  predefined symbols such as __SSE2__, _M_X64.
 //
+//  count_u16_sse2_nt() is large-scan mode.  It uses non-temporal prefetch to
+//  avoid evicting other working sets from L2/LLC.  It can be several times
+//  slower than count_u16_sse2().  See README.md for measurements.
+//  If you define COUNT_LARGE_SCAN_THRESHOLD (in bytes) before including this
+//  header, count_u16() selects it when the size of memory region is equal to
+//  or larger than the threshold.
+//
 //
 // # References
 //
@@ -31,6 +38,7 @@
 #ifndef COUNT_U16_H
 #define COUNT_U16_H
 
+#include "count_u_select.h"
 #include <stdint.h>
 
 #if defined(_MSC_VER)
@@ -97,7 +105,10 @@ static inline size_t count_u16_scalar(const void* src, size_t srcSizeInBytes, ui
 
 
 // SSE2
-static inline size_t count_u16_sse2(const void* src, size_t srcSizeInBytes, uint16_t value) {
+//
+//  When nonTemporal != 0, we use prefetchnta instead of prefetcht0.
+//  See also count_u8_sse2_impl_() in count_u8.h.
+static inline size_t count_u16_sse2_impl_(const void* src, size_t srcSizeInBytes, uint16_t value, int nonTemporal) {
     const uint64_t          bytesPerLoop    = 16 * 4;
     const int               prefetchLen     = 4096;
 
@@ -138,9 +149,17 @@ static inline size_t count_u16_sse2(const void* src, size_t srcSizeInBytes, uint
 
                 const uint8_t*  prefetchPtr     = p + prefetchLen;
     #if defined(_MSC_VER)
-                _mm_prefetch((const char*) prefetchPtr, _MM_HINT_T0);
+                if(nonTemporal) {
+                    _mm_prefetch((const char*) prefetchPtr, _MM_HINT_NTA);
+                } else {
+                    _mm_prefetch((const char*) prefetchPtr, _MM_HINT_T0);
+                }
     #elif defined(__GNUC__)
-                __builtin_prefetch(prefetchPtr, 0, 3);
+                if(nonTemporal) {
+                    __builtin_prefetch(prefetchPtr, 0, 0);
+                } else {
+                    __builtin_prefetch(prefetchPtr, 0, 3);
+                }
     #else
     #  error
     #endif
@@ -194,15 +213,29 @@ static inline size_t count_u16_sse2(const void* src, size_t srcSizeInBytes, uint
 }
 
 
+// SSE2
+static inline size_t count_u16_sse2(const void* src, size_t srcSizeInBytes, uint16_t value) {
+    return count_u16_sse2_impl_(src, srcSizeInBytes, value, 0);
+}
+
+
+// SSE2 (large-scan, non-temporal prefetch)
+static inline size_t count_u16_sse2_nt(const void* src, size_t srcSizeInBytes, uint16_t value) {
+    return count_u16_sse2_impl_(src, srcSizeInBytes, value, 1);
+}
+
+
 // "Default".  Select SSE2 if it's available.
+//  Select large-scan mode if srcSize >= COUNT_LARGE_SCAN_THRESHOLD (optional).
+//  See count_u_select.h.
 static inline size_t count_u16(const void* src, size_t srcSize, uint16_t value) {
-#if defined(__SSE2__)   /* generic */ \
- || defined(__x86_64__) /* gcc */ \
- || defined(_M_X64)     /* MSVC, https://docs.microsoft.com/en-us/cpp/preprocessor/predefined-macros */
-    return count_u16_sse2(src, srcSize, value);
-#else
-    return count_u16_scalar(src, srcSize, value);
+    switch(count_u_select_kernel(srcSize)) {
+#if defined(COUNT_U_HAS_SSE2)
+    case COUNT_U_KERNEL_SSE2_NT:    return count_u16_sse2_nt(src, srcSize, value);
+    case COUNT_U_KERNEL_SSE2:       return count_u16_sse2(src, srcSize, value);
 #endif
+    default:                        return count_u16_scalar(src, srcSize, value);
+    }
 }
 
 #endif // COUNT_U16_H
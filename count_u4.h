@@ -0,0 +1,178 @@
+﻿// Count the number of 4bit (nibble) elements in memory region.
+// Header-only library in C99.  Optimized for SSE2.
+//
+// # Usage
+//
+//      size_t bufSize = 65536;
+//      uint8_t* buf = (uint8_t*) malloc(bufSize);
+//
+//      ... set_some_values(buf, bufSize); ...
+//
+//      uint8_t nibble = 0x5;
+//      size_t numElem = count_u4(buf, bufSize, nibble);
+//
+//  Each byte holds two packed elements (bits 0-3 and bits 4-7).  Both of
+//  them are compared with nibble.  Upper 4 bits of nibble are ignored.
+//
+//  count_u4() automatically detect supported instruction by compiler's
+//  predefined symbols such as __SSE2__, _M_X64.
+//
+//
+// # References
+//
+// - Intel Intrinsics Guide
+//   https://software.intel.com/sites/landingpage/IntrinsicsGuide/
+//
+//
+// # License
+//
+//  SPDX-FileCopyrightText: Copyright (c) Takayuki Matsuoka
+//  SPDX-License-Identifier: CC0-1.0
+//  https://spdx.org/licenses/CC0-1.0
+//  https://creativecommons.org/publicdomain/zero/1.0/
+
+#ifndef COUNT_U4_H
+#define COUNT_U4_H
+
+#include "count_u_select.h"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#elif defined(__GNUC__)
+#  include <x86intrin.h>
+#else
+#  error
+#endif
+
+// Scalar (naive)
+static inline size_t count_u4_scalar_naive(const void* src, size_t srcSizeInBytes, uint8_t nibble) {
+    const uint8_t* data = (const uint8_t*) src;
+    const uint8_t v = nibble & 0x0f;
+    uint64_t counter = 0;
+    for(size_t i = 0; i < srcSizeInBytes; ++i) {
+        counter += ((data[i] & 0x0f) == v) ? 1 : 0;
+        counter += ((data[i] >> 4)   == v) ? 1 : 0;
+    }
+    return (size_t) counter;
+}
+
+
+// Scalar (SWAR, 64bit)
+//
+//  y = x ^ (nibble * 0x1111...) has zero nibbles where x matches.
+//  (y | y>>1 | y>>2 | y>>3) & 0x1111... sets bit 0 of each non-zero nibble.
+//  Since only bits 0-3 of a nibble reach its bit 0, nibbles don't interfere.
+//  Then we count them and subtract from 16 (nibbles per uint64_t).
+static inline size_t count_u4_scalar(const void* src, size_t srcSizeInBytes, uint8_t nibble) {
+    const uint64_t m1  = 0x1111111111111111ULL;
+    const uint64_t m4  = 0x0f0f0f0f0f0f0f0fULL;
+    const uint64_t h01 = 0x0101010101010101ULL;
+    const uint64_t c   = (uint64_t) (nibble & 0x0f) * m1;
+
+    const uint8_t* const    data        = (const uint8_t*) src;
+    const uint8_t* const    endOfData   = data + srcSizeInBytes;
+    const uint8_t* const    endOfU64    = endOfData - (srcSizeInBytes % sizeof(uint64_t));
+
+    uint64_t counter = 0;
+    for(const uint8_t* p = data; p < endOfU64; p += sizeof(uint64_t)) {
+        uint64_t x;
+        memcpy(&x, p, sizeof(x));
+        uint64_t y = x ^ c;
+        y |= y >> 1;
+        y |= y >> 2;
+        y &= m1;                            // bit 0 of each nibble = non-zero
+        y  = (y + (y >> 4)) & m4;           // 0..2 per byte
+        counter += 16 - ((y * h01) >> 56);
+    }
+
+    counter += count_u4_scalar_naive(endOfU64, (size_t) (endOfData - endOfU64), nibble);
+
+    return (size_t) counter;
+}
+
+
+// SSE2
+//
+//  Each byte is split into low and high nibbles, and both are compared
+//  with c.  Since compare result is 0x00 or 0xff (-1), (0 - cmpLo - cmpHi)
+//  gives the number of matches (0, 1 or 2) in each 8bit lane.
+//  We sum four vectors of them in 8bit lanes (max 8, no overflow) and
+//  reduce it by _mm_sad_epu8() against zero once per loop.
+static inline size_t count_u4_sse2(const void* src, size_t srcSizeInBytes, uint8_t nibble) {
+    const uint64_t          bytesPerLoop    = 16 * 4;
+    const int               prefetchLen     = 4096;
+
+    const uint8_t* const    data            = (const uint8_t*) src;
+    const uint8_t* const    endOfData       = data + srcSizeInBytes;
+    const uint8_t* const    endOfSimdPart   = endOfData - (srcSizeInBytes % bytesPerLoop);
+
+    uint64_t simdPartCounter = 0;
+    {
+        __m128i         sum_64x2    = _mm_setzero_si128();
+        const __m128i   zero_8x16   = _mm_setzero_si128();
+        const __m128i   mask_8x16   = _mm_set1_epi8(0x0f);
+        const __m128i   c_8x16      = _mm_set1_epi8((char) (nibble & 0x0f));
+
+        for(const uint8_t* p = data; p < endOfSimdPart; p += bytesPerLoop) {
+            const uint8_t*  prefetchPtr     = p + prefetchLen;
+#if defined(_MSC_VER)
+            _mm_prefetch((const char*) prefetchPtr, _MM_HINT_T0);
+#elif defined(__GNUC__)
+            __builtin_prefetch(prefetchPtr, 0, 3);
+#else
+#  error
+#endif
+
+            const __m128i*  m               = (const __m128i *) p;
+            const __m128i   v0_8x16         = _mm_loadu_si128(m  );
+            const __m128i   v1_8x16         = _mm_loadu_si128(m+1);
+            const __m128i   v2_8x16         = _mm_loadu_si128(m+2);
+            const __m128i   v3_8x16         = _mm_loadu_si128(m+3);
+
+            const __m128i   lo0_8x16        = _mm_and_si128(v0_8x16, mask_8x16);
+            const __m128i   lo1_8x16        = _mm_and_si128(v1_8x16, mask_8x16);
+            const __m128i   lo2_8x16        = _mm_and_si128(v2_8x16, mask_8x16);
+            const __m128i   lo3_8x16        = _mm_and_si128(v3_8x16, mask_8x16);
+
+            const __m128i   hi0_8x16        = _mm_and_si128(_mm_srli_epi16(v0_8x16, 4), mask_8x16);
+            const __m128i   hi1_8x16        = _mm_and_si128(_mm_srli_epi16(v1_8x16, 4), mask_8x16);
+            const __m128i   hi2_8x16        = _mm_and_si128(_mm_srli_epi16(v2_8x16, 4), mask_8x16);
+            const __m128i   hi3_8x16        = _mm_and_si128(_mm_srli_epi16(v3_8x16, 4), mask_8x16);
+
+            __m128i         n_8x16          = zero_8x16;
+            n_8x16 = _mm_sub_epi8(n_8x16, _mm_cmpeq_epi8(c_8x16, lo0_8x16));
+            n_8x16 = _mm_sub_epi8(n_8x16, _mm_cmpeq_epi8(c_8x16, hi0_8x16));
+            n_8x16 = _mm_sub_epi8(n_8x16, _mm_cmpeq_epi8(c_8x16, lo1_8x16));
+            n_8x16 = _mm_sub_epi8(n_8x16, _mm_cmpeq_epi8(c_8x16, hi1_8x16));
+            n_8x16 = _mm_sub_epi8(n_8x16, _mm_cmpeq_epi8(c_8x16, lo2_8x16));
+            n_8x16 = _mm_sub_epi8(n_8x16, _mm_cmpeq_epi8(c_8x16, hi2_8x16));
+            n_8x16 = _mm_sub_epi8(n_8x16, _mm_cmpeq_epi8(c_8x16, lo3_8x16));
+            n_8x16 = _mm_sub_epi8(n_8x16, _mm_cmpeq_epi8(c_8x16, hi3_8x16));
+
+            sum_64x2 = _mm_add_epi64(sum_64x2, _mm_sad_epu8(n_8x16, zero_8x16));
+        }
+
+        uint64_t counters[2];
+        _mm_storeu_si128((__m128i*) counters, sum_64x2);
+
+        simdPartCounter  = (counters[0] + counters[1]);
+    }
+
+    const uint64_t lastPartCounter = count_u4_scalar(endOfSimdPart, (size_t) (endOfData - endOfSimdPart), nibble);
+
+    return (size_t) (simdPartCounter + lastPartCounter);
+}
+
+
+// "Default".  Select SSE2 if it's available.
+static inline size_t count_u4(const void* src, size_t srcSizeInBytes, uint8_t nibble) {
+#if defined(COUNT_U_HAS_SSE2)
+    return count_u4_sse2(src, srcSizeInBytes, nibble);
+#else
+    return count_u4_scalar(src, srcSizeInBytes, nibble);
+#endif
+}
+
+#endif // COUNT_U4_H
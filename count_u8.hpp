@@ -0,0 +1,222 @@
+﻿// C++20 wrapper for count_u8.h and count_u16.h
+// Header-only library.  Provides std::span based API.
+//
+// # Usage
+//
+//      std::vector<uint8_t> buf(65536);
+//
+//      ... set_some_values(buf); ...
+//
+//      size_t numElem = count_u::count(buf, uint8_t(0x42));
+//
+//      // Select kernel at compile time.
+//      size_t numElemSse2 = count_u::count<count_u::kernel::sse2>(buf, uint8_t(0x42));
+//
+//      // Split the region and count it with multiple threads.
+//      size_t numElemPar = count_u::count(std::execution::par, buf, uint8_t(0x42));
+//
+//      std::span<const uint16_t> buf16 = ...;
+//      size_t numElem16 = count_u::count(buf16, uint16_t(0x4251));
+//
+//  count_u::kernel::automatic (default) calls count_u8() or count_u16(), so
+//  it follows their instruction and large-scan mode selection.
+//
+//
+// # License
+//
+//  SPDX-FileCopyrightText: Copyright (c) Takayuki Matsuoka
+//  SPDX-License-Identifier: CC0-1.0
+//  https://spdx.org/licenses/CC0-1.0
+//  https://creativecommons.org/publicdomain/zero/1.0/
+
+#ifndef COUNT_U8_HPP
+#define COUNT_U8_HPP
+
+#if __cplusplus < 202002L && !(defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#  error count_u8.hpp requires C++20
+#endif
+
+#include "count_u8.h"
+#include "count_u16.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <execution>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace count_u {
+
+// Kernel which is selected at compile time.
+enum class kernel {
+    automatic,          // count_u8(), count_u16()
+    scalar_naive,       // count_u8_scalar_naive(), count_u16_scalar_naive()
+    scalar_intloop,     // count_u8_scalar_intloop(), count_u16_scalar_intloop()
+    scalar,             // count_u8_scalar(), count_u16_scalar()
+    sse2,               // count_u8_sse2(), count_u16_sse2()
+    sse2_nt,            // count_u8_sse2_nt(), count_u16_sse2_nt()
+};
+
+
+namespace detail {
+
+template<kernel K>
+inline size_t count_u8_(const uint8_t* src, size_t srcSizeInBytes, uint8_t value) {
+    if constexpr(K == kernel::scalar_naive) {
+        return count_u8_scalar_naive(src, srcSizeInBytes, value);
+    } else if constexpr(K == kernel::scalar_intloop) {
+        return count_u8_scalar_intloop(src, srcSizeInBytes, value);
+    } else if constexpr(K == kernel::scalar) {
+        return count_u8_scalar(src, srcSizeInBytes, value);
+    } else if constexpr(K == kernel::sse2) {
+        return count_u8_sse2(src, srcSizeInBytes, value);
+    } else if constexpr(K == kernel::sse2_nt) {
+        return count_u8_sse2_nt(src, srcSizeInBytes, value);
+    } else {
+        return ::count_u8(src, srcSizeInBytes, value);
+    }
+}
+
+
+template<kernel K>
+inline size_t count_u16_(const uint16_t* src, size_t srcSizeInBytes, uint16_t value) {
+    if constexpr(K == kernel::scalar_naive) {
+        return count_u16_scalar_naive(src, srcSizeInBytes, value);
+    } else if constexpr(K == kernel::scalar_intloop) {
+        return count_u16_scalar_intloop(src, srcSizeInBytes, value);
+    } else if constexpr(K == kernel::scalar) {
+        return count_u16_scalar(src, srcSizeInBytes, value);
+    } else if constexpr(K == kernel::sse2) {
+        return count_u16_sse2(src, srcSizeInBytes, value);
+    } else if constexpr(K == kernel::sse2_nt) {
+        return count_u16_sse2_nt(src, srcSizeInBytes, value);
+    } else {
+        return ::count_u16(src, srcSizeInBytes, value);
+    }
+}
+
+
+template<kernel K, class T>
+inline size_t count_(std::span<const T> src, T value) {
+    if constexpr(std::is_same_v<T, uint8_t>) {
+        return count_u8_<K>(src.data(), src.size_bytes(), value);
+    } else {
+        return count_u16_<K>(src.data(), src.size_bytes(), value);
+    }
+}
+
+
+template<class ExecutionPolicy>
+inline constexpr bool is_parallel_policy_v =
+       std::is_same_v<std::remove_cvref_t<ExecutionPolicy>, std::execution::parallel_policy>
+    || std::is_same_v<std::remove_cvref_t<ExecutionPolicy>, std::execution::parallel_unsequenced_policy>;
+
+
+// Number of chunks which count_par_() uses for src.
+//  Each chunk is at least minChunkSizeInBytes, so small region is counted
+//  by the calling thread only.
+template<class T>
+inline size_t num_chunks_(std::span<const T> src) {
+    constexpr size_t minChunkSizeInBytes = 1024 * 1024;
+    constexpr size_t minChunkSize        = minChunkSizeInBytes / sizeof(T);
+
+    const size_t hw = std::max<size_t>(1, std::thread::hardware_concurrency());
+    return std::clamp<size_t>(src.size() / minChunkSize, 1, hw);
+}
+
+
+// Split src into nChunk chunks and count each of them by its own thread.
+//  kernel::automatic is resolved here from the size of whole region by
+//  count_u_select_kernel(), as count_u8() and count_u16() do.  Otherwise
+//  each chunk would be compared with COUNT_LARGE_SCAN_THRESHOLD separately.
+template<kernel K, class T>
+inline size_t count_par_(std::span<const T> src, T value, size_t nChunk) {
+    if constexpr(K == kernel::automatic) {
+        switch(count_u_select_kernel(src.size_bytes())) {
+        case COUNT_U_KERNEL_SSE2_NT:    return count_par_<kernel::sse2_nt>(src, value, nChunk);
+        case COUNT_U_KERNEL_SSE2:       return count_par_<kernel::sse2>(src, value, nChunk);
+        default:                        return count_par_<kernel::scalar>(src, value, nChunk);
+        }
+    } else {
+        if(nChunk <= 1) {
+            return count_<K>(src, value);
+        }
+
+        // Round chunk size up to 64 bytes to keep SIMD loop of each chunk aligned.
+        constexpr size_t align  = 64 / sizeof(T);
+        const size_t chunkSize  = ((src.size() + nChunk - 1) / nChunk + align - 1) / align * align;
+
+        // std::jthread joins in its destructor, so threads which are already
+        // started are joined even if emplace_back() throws.
+        std::vector<size_t>       counters(nChunk, 0);
+        std::vector<std::jthread> threads;
+        threads.reserve(nChunk - 1);
+        for(size_t i = 1; i < nChunk; ++i) {
+            const size_t offset = std::min(src.size(), i * chunkSize);
+            const size_t size   = std::min(src.size() - offset, chunkSize);
+            threads.emplace_back([&counters, i, chunk = src.subspan(offset, size), value] {
+                counters[i] = count_<K>(chunk, value);
+            });
+        }
+        counters[0] = count_<K>(src.first(std::min(src.size(), chunkSize)), value);
+
+        for(auto& t : threads) {
+            t.join();
+        }
+
+        size_t counter = 0;
+        for(const size_t c : counters) {
+            counter += c;
+        }
+        return counter;
+    }
+}
+
+} // namespace detail
+
+
+// Count the number of uint8_t elements.
+template<kernel K = kernel::automatic>
+inline size_t count(std::span<const uint8_t> src, uint8_t value) {
+    return detail::count_<K>(src, value);
+}
+
+
+// Count the number of uint16_t elements.
+template<kernel K = kernel::automatic>
+inline size_t count(std::span<const uint16_t> src, uint16_t value) {
+    return detail::count_<K>(src, value);
+}
+
+
+// Count the number of uint8_t elements with execution policy.
+//  std::execution::par and par_unseq use multiple threads.  Others count
+//  it in the calling thread.
+template<kernel K = kernel::automatic, class ExecutionPolicy>
+    requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+inline size_t count(ExecutionPolicy&&, std::span<const uint8_t> src, uint8_t value) {
+    if constexpr(detail::is_parallel_policy_v<ExecutionPolicy>) {
+        return detail::count_par_<K>(src, value, detail::num_chunks_(src));
+    } else {
+        return detail::count_<K>(src, value);
+    }
+}
+
+
+// Count the number of uint16_t elements with execution policy.
+template<kernel K = kernel::automatic, class ExecutionPolicy>
+    requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+inline size_t count(ExecutionPolicy&&, std::span<const uint16_t> src, uint16_t value) {
+    if constexpr(detail::is_parallel_policy_v<ExecutionPolicy>) {
+        return detail::count_par_<K>(src, value, detail::num_chunks_(src));
+    } else {
+        return detail::count_<K>(src, value);
+    }
+}
+
+} // namespace count_u
+
+#endif // COUNT_U8_HPP
@@ -0,0 +1,54 @@
+﻿// Kernel selection of count_u8(), count_u16(), count_u1() and count_u4().
+// Header-only library in C99.  Included by them, so you don't need to
+// include it directly.
+//
+//  COUNT_U_HAS_SSE2 is defined when SSE2 is available, by compiler's
+//  predefined symbols such as __SSE2__, _M_X64.
+//
+//  count_u_select_kernel() returns the kernel which the "Default" functions
+//  use for a memory region of srcSizeInBytes.  Large-scan mode is selected
+//  only if COUNT_LARGE_SCAN_THRESHOLD (in bytes) is defined before including
+//  the headers.  count_u8.hpp uses it to select the kernel once for the
+//  whole region, before splitting it.
+//
+//
+// # License
+//
+//  SPDX-FileCopyrightText: Copyright (c) Takayuki Matsuoka
+//  SPDX-License-Identifier: CC0-1.0
+//  https://spdx.org/licenses/CC0-1.0
+//  https://creativecommons.org/publicdomain/zero/1.0/
+
+#ifndef COUNT_U_SELECT_H
+#define COUNT_U_SELECT_H
+
+#include <stddef.h>
+
+#if defined(__SSE2__)   /* generic */ \
+ || defined(__x86_64__) /* gcc */ \
+ || defined(_M_X64)     /* MSVC, https://docs.microsoft.com/en-us/cpp/preprocessor/predefined-macros */
+#  define COUNT_U_HAS_SSE2 1
+#endif
+
+typedef enum {
+    COUNT_U_KERNEL_SCALAR,
+    COUNT_U_KERNEL_SSE2,
+    COUNT_U_KERNEL_SSE2_NT,     // Large-scan mode
+} count_u_kernel;
+
+static inline count_u_kernel count_u_select_kernel(size_t srcSizeInBytes) {
+#if defined(COUNT_U_HAS_SSE2)
+#  if defined(COUNT_LARGE_SCAN_THRESHOLD)
+    if(srcSizeInBytes >= (size_t) (COUNT_LARGE_SCAN_THRESHOLD)) {
+        return COUNT_U_KERNEL_SSE2_NT;
+    }
+#  endif
+    (void) srcSizeInBytes;
+    return COUNT_U_KERNEL_SSE2;
+#else
+    (void) srcSizeInBytes;
+    return COUNT_U_KERNEL_SCALAR;
+#endif
+}
+
+#endif // COUNT_U_SELECT_H